@@ -0,0 +1,325 @@
+#include "CaptureCheckpoint.h"
+
+#ifdef TARGET_WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------
+// File layout
+//--------------------------------------------------------------
+// Header: "PMC2", file length (int), number of bands (int), radial start and end, line resolution and decay rate (float),
+// track name length (int), track name
+// Then one record per spectrum line: angle (float), track position in ms (int), band values (float * number of bands)
+// A record cut short by a crash is ignored and overwritten by the next line written
+// A file with a complete header that doesn't match the current settings is renamed to <file>.<time>.old
+// Each batch is synced to disk so the checkpoint also survives a power loss or reboot
+// If a write fails, nothing more is written so a partial record can only ever be the last one
+
+static const char checkpointMagic[4] = { 'P', 'M', 'C', '2' };
+
+// The writer thread sleeps in slices this long so stop() never waits for a whole interval
+static const int checkpointSleepSliceMS = 10;
+
+// Push everything written so far out of the OS cache and onto the disk
+static bool syncToDisk(FILE *file) {
+    if (fflush(file) != 0) {
+        return false;
+    }
+#ifdef TARGET_WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+//--------------------------------------------------------------
+CaptureCheckpoint::~CaptureCheckpoint() {
+    stop();
+}
+
+//--------------------------------------------------------------
+void CaptureCheckpoint::setup(string path, CheckpointSettings settings, int intervalMS) {
+    this->filePath = ofToDataPath(path);
+    this->settings = settings;
+    this->intervalMS = max(intervalMS, checkpointSleepSliceMS);
+    bEnabled = true;
+}
+
+//--------------------------------------------------------------
+bool CaptureCheckpoint::load(vector< vector<float> > &lines, vector<float> &angles, vector<int> &positions) {
+
+    lines.clear();
+    angles.clear();
+    positions.clear();
+    resumeOffset = 0;
+
+    ifstream in(filePath.c_str(), ios::binary);
+
+    if (!in.is_open()) {
+        return false;
+    }
+
+    HeaderStatus status = readHeader(in);
+
+    // A header that was never completely written holds no lines, so start again from scratch
+    if (status == HEADER_INCOMPLETE) {
+        return false;
+    }
+
+    // A capture from a different track or different settings may still be wanted, so keep it
+    if (status == HEADER_MISMATCH) {
+        in.close();
+        keepMismatchedFile();
+        return false;
+    }
+
+    resumeOffset = (long)in.tellg();
+
+    vector<float> values(settings.numBands);
+    float angle;
+    int positionMS;
+
+    // Read whole lines until the end of the file, the last one may have been partly written
+    while (in.read((char *)&angle, sizeof(float)) && in.read((char *)&positionMS, sizeof(int))
+           && in.read((char *)&values[0], sizeof(float) * settings.numBands)) {
+        lines.push_back(values);
+        angles.push_back(angle);
+        positions.push_back(positionMS);
+
+        resumeOffset = (long)in.tellg();
+    }
+
+    return !lines.empty();
+}
+
+//--------------------------------------------------------------
+void CaptureCheckpoint::start() {
+
+    if (!bEnabled) {
+        return;
+    }
+
+    if (resumeOffset > 0) {
+        // Open without truncating and carry on after the last complete line
+        file = fopen(filePath.c_str(), "r+b");
+    } else {
+        file = fopen(filePath.c_str(), "wb");
+    }
+
+    if (file == NULL) {
+        ofLogError("CaptureCheckpoint") << "unable to open checkpoint file " << filePath;
+        return;
+    }
+
+    bool bReady;
+
+    if (resumeOffset > 0) {
+        bReady = fseek(file, resumeOffset, SEEK_SET) == 0;
+    } else {
+        bReady = writeHeader();
+    }
+
+    if (!bReady) {
+        ofLogError("CaptureCheckpoint") << "unable to write to checkpoint file " << filePath;
+        fclose(file);
+        file = NULL;
+        return;
+    }
+
+    syncedOffset = ftell(file);
+    bWriteFailed = false;
+
+    bWriting = true;
+    startThread(true, false);
+}
+
+//--------------------------------------------------------------
+void CaptureCheckpoint::stop() {
+
+    bWriting = false;
+
+    if (isThreadRunning()) {
+        waitForThread(true);
+    }
+
+    // Write out anything queued since the thread last woke up
+    if (file != NULL) {
+        writePendingLines();
+        fclose(file);
+        file = NULL;
+    }
+}
+
+//--------------------------------------------------------------
+void CaptureCheckpoint::remove() {
+
+    // Only delete a file this run has been writing, never one that failed to open or was kept for another capture
+    if (filePath == "" || !bWriting) {
+        stop();
+        return;
+    }
+
+    // The file is about to be deleted so there's no need to write the queued lines
+    lock();
+    pendingLines.clear();
+    pendingAngles.clear();
+    pendingPositions.clear();
+    unlock();
+
+    stop();
+
+    ofFile::removeFile(filePath, false);
+    resumeOffset = 0;
+}
+
+//--------------------------------------------------------------
+void CaptureCheckpoint::addLine(const vector<float> &values, float angle, int positionMS) {
+
+    if (!bWriting) {
+        return;
+    }
+
+    lock();
+    pendingLines.push_back(values);
+    pendingAngles.push_back(angle);
+    pendingPositions.push_back(positionMS);
+    unlock();
+}
+
+//--------------------------------------------------------------
+void CaptureCheckpoint::threadedFunction() {
+
+    while (isThreadRunning()) {
+        writePendingLines();
+
+        for (int slept = 0; slept < intervalMS && isThreadRunning(); slept += checkpointSleepSliceMS) {
+            ofSleepMillis(checkpointSleepSliceMS);
+        }
+    }
+}
+
+//--------------------------------------------------------------
+bool CaptureCheckpoint::writeHeader() {
+
+    int nameLength = settings.trackName.size();
+
+    return fwrite(checkpointMagic, sizeof(checkpointMagic), 1, file) == 1
+        && fwrite(&settings.fileLength, sizeof(int), 1, file) == 1
+        && fwrite(&settings.numBands, sizeof(int), 1, file) == 1
+        && fwrite(&settings.radialPosStart, sizeof(float), 1, file) == 1
+        && fwrite(&settings.radialPosEnd, sizeof(float), 1, file) == 1
+        && fwrite(&settings.lineResolution, sizeof(float), 1, file) == 1
+        && fwrite(&settings.decayRate, sizeof(float), 1, file) == 1
+        && fwrite(&nameLength, sizeof(int), 1, file) == 1
+        && fwrite(settings.trackName.c_str(), 1, nameLength, file) == (size_t)nameLength
+        && syncToDisk(file);
+}
+
+//--------------------------------------------------------------
+CaptureCheckpoint::HeaderStatus CaptureCheckpoint::readHeader(ifstream &in) {
+
+    char magic[4];
+    CheckpointSettings fileSettings;
+    int nameLength;
+
+    if (!in.read(magic, sizeof(magic))) {
+        return HEADER_INCOMPLETE;
+    }
+
+    // Not a checkpoint in this format, it could be from an older version so leave it be
+    if (memcmp(magic, checkpointMagic, sizeof(magic)) != 0) {
+        return HEADER_MISMATCH;
+    }
+
+    if (!in.read((char *)&fileSettings.fileLength, sizeof(int))
+        || !in.read((char *)&fileSettings.numBands, sizeof(int))
+        || !in.read((char *)&fileSettings.radialPosStart, sizeof(float))
+        || !in.read((char *)&fileSettings.radialPosEnd, sizeof(float))
+        || !in.read((char *)&fileSettings.lineResolution, sizeof(float))
+        || !in.read((char *)&fileSettings.decayRate, sizeof(float))
+        || !in.read((char *)&nameLength, sizeof(int))) {
+        return HEADER_INCOMPLETE;
+    }
+
+    if (nameLength < 0) {
+        return HEADER_MISMATCH;
+    }
+
+    fileSettings.trackName.assign(nameLength, ' ');
+
+    if (nameLength > 0 && !in.read(&fileSettings.trackName[0], nameLength)) {
+        return HEADER_INCOMPLETE;
+    }
+
+    // Any of these changing would mix radii or the angle to time mapping within the one mesh
+    if (fileSettings.fileLength != settings.fileLength
+        || fileSettings.numBands != settings.numBands
+        || fileSettings.radialPosStart != settings.radialPosStart
+        || fileSettings.radialPosEnd != settings.radialPosEnd
+        || fileSettings.lineResolution != settings.lineResolution
+        || fileSettings.decayRate != settings.decayRate
+        || fileSettings.trackName != settings.trackName) {
+        return HEADER_MISMATCH;
+    }
+
+    return HEADER_MATCH;
+}
+
+//--------------------------------------------------------------
+void CaptureCheckpoint::keepMismatchedFile() {
+
+    string oldPath = filePath + "." + ofToString(ofGetUnixTime()) + ".old";
+
+    if (ofFile::moveFromTo(filePath, oldPath, false, false)) {
+        ofLogWarning("CaptureCheckpoint") << filePath << " is from a different track or settings, moved it to " << oldPath;
+    } else {
+        ofLogWarning("CaptureCheckpoint") << filePath << " is from a different track or settings and couldn't be moved, "
+                                          << "checkpoints are off for this run";
+        bEnabled = false;
+    }
+}
+
+//--------------------------------------------------------------
+void CaptureCheckpoint::writePendingLines() {
+
+    // Hold the lock just long enough to take the queued lines so addLine() never waits on the disk,
+    // the sync below can take a while but only ever blocks the writer thread
+    lock();
+    writingLines.swap(pendingLines);
+    writingAngles.swap(pendingAngles);
+    writingPositions.swap(pendingPositions);
+    unlock();
+
+    if (writingLines.empty()) {
+        return;
+    }
+
+    // Once a write has failed the queued lines are dropped, anything appended after a partial line
+    // would be read back misaligned
+    if (!bWriteFailed) {
+        bool bWritten = true;
+
+        for (int i = 0; i < writingLines.size() && bWritten; i++) {
+            bWritten = fwrite(&writingAngles[i], sizeof(float), 1, file) == 1
+                    && fwrite(&writingPositions[i], sizeof(int), 1, file) == 1
+                    && fwrite(&writingLines[i][0], sizeof(float), settings.numBands, file) == (size_t)settings.numBands;
+        }
+
+        if (bWritten && syncToDisk(file)) {
+            syncedOffset = ftell(file);
+        } else {
+            // Go back to the end of the last synced line, whatever made it to disk after that is a partial tail
+            clearerr(file);
+            fseek(file, syncedOffset, SEEK_SET);
+
+            ofLogError("CaptureCheckpoint") << "unable to write to checkpoint file " << filePath << ", no more lines will be checkpointed";
+            bWriteFailed = true;
+        }
+    }
+
+    writingLines.clear();
+    writingAngles.clear();
+    writingPositions.clear();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ofMain.h"
+
+// Settings which change the shape or timing of the mesh, a checkpoint is only resumed if they all match
+struct CheckpointSettings {
+    string trackName;
+    int fileLength;
+    int numBands;
+    float radialPosStart;
+    float radialPosEnd;
+    float lineResolution;
+    float decayRate;
+};
+
+// Appends each spectrum line added to the mesh to a file in the data folder from a background thread
+// so that a capture can be picked up again after a crash instead of replaying the whole track
+class CaptureCheckpoint : public ofThread {
+
+    public:
+        ~CaptureCheckpoint();
+
+        // The settings are written into the file header and checked against it by load()
+        void setup(string path, CheckpointSettings settings, int intervalMS);
+
+        // Read back the lines from an earlier capture, returns false if there is nothing to resume.
+        // A checkpoint from a different track or settings is moved aside rather than overwritten
+        bool load(vector< vector<float> > &lines, vector<float> &angles, vector<int> &positions);
+
+        // Open the file and start writing lines, continues on from the lines returned by load()
+        void start();
+        void stop();
+
+        // Stop writing and delete the file once the mesh has been finished, does nothing to the file
+        // if checkpoints were never started
+        void remove();
+
+        // Called from the main thread, only copies the line into a queue for the writer thread
+        void addLine(const vector<float> &values, float angle, int positionMS);
+
+    protected:
+        void threadedFunction();
+
+    private:
+        enum HeaderStatus {
+            HEADER_INCOMPLETE,          // Cut short before the header was completely written, safe to start over
+            HEADER_MISMATCH,            // Another track, other settings or another format, must not be overwritten
+            HEADER_MATCH
+        };
+
+        bool writeHeader();
+        HeaderStatus readHeader(ifstream &in);
+        void keepMismatchedFile();
+        void writePendingLines();
+
+        string filePath;
+        CheckpointSettings settings;
+        int intervalMS;                 // How often the writer thread flushes queued lines to the file
+        bool bWriting = false;          // Only used on the main thread so addLine() never touches the file
+        bool bEnabled = true;           // Turned off if a mismatched checkpoint couldn't be moved out of the way
+
+        FILE *file = NULL;              // Plain file handle so each batch can be synced to disk
+        long resumeOffset = 0;          // End of the last complete line read by load(), 0 to start a new file
+        long syncedOffset = 0;          // End of the last line synced to disk, only used by the writer thread
+        bool bWriteFailed = false;      // Set by the writer thread so nothing is written after a partial line
+
+        vector< vector<float> > pendingLines;   // Queued by addLine() and swapped out by the writer thread
+        vector<float> pendingAngles;
+        vector<int> pendingPositions;
+        vector< vector<float> > writingLines;   // Only touched by the writer thread
+        vector<float> writingAngles;
+        vector<int> writingPositions;
+};
@@ -14,7 +14,8 @@ void ofApp::setup(){
     ofSetFrameRate(60);
     
     // Load the settings file for the spring parameters
-    if( XML.loadFile("settings.local.xml") ){
+    bool bSettingsLoaded = XML.loadFile("settings.local.xml");
+    if( bSettingsLoaded ){
         cout << "settings.xml loaded" << endl;
     } else {
         cout << "unable to load settings.local.xml check data/ folder" << endl;
@@ -33,6 +34,17 @@ void ofApp::setup(){
     radPosEnd = XML.getValue("settings:radial-position-end", 1000);
     lineResolution = XML.getValue("settings:line-resolution", 1);
     surfaceDepth = XML.getValue("settings:base-surface-depth", -20);
+    bAdaptiveLines = XML.getValue("settings:adaptive-lines", 0) != 0;
+    adaptiveErrorBound = XML.getValue("settings:adaptive-error-bound", 1.0);
+    adaptiveMaxSkip = max(XML.getValue("settings:adaptive-max-skip", 10), 0);
+    checkpointFile = XML.getValue("settings:checkpoint-file", "capture.checkpoint");
+    checkpointInterval = XML.getValue("settings:checkpoint-interval", 1000);
+    
+    // The defaults won't match any real capture, so don't let them touch an existing checkpoint
+    if (!bSettingsLoaded && checkpointFile != "") {
+        cout << "settings not loaded, checkpoints are off for this run" << endl;
+        checkpointFile = "";
+    }
     
     // Set up sound sample
     sound.loadSound(fileName);
@@ -48,6 +60,22 @@ void ofApp::setup(){
         spectrum[i] = 0.0f;
     }
     
+    // Pick up the lines from a capture which didn't finish and carry on recording new ones
+    if (checkpointFile != "") {
+        CheckpointSettings settings;
+        settings.trackName = fileName;
+        settings.fileLength = fileLength;
+        settings.numBands = numSpectrumBands;
+        settings.radialPosStart = radPostStart;
+        settings.radialPosEnd = radPosEnd;
+        settings.lineResolution = lineResolution;
+        settings.decayRate = decayRate;
+        
+        checkpoint.setup(checkpointFile, settings, checkpointInterval);
+        resumeFromCheckpoint();
+        checkpoint.start();
+    }
+    
     cam.setFarClip(20000);
     cam.setDistance(2000);
     
@@ -98,7 +126,12 @@ void ofApp::update(){
         
         // If the key to dump a mesh .ply file has been pressed then we shouldn't add any more spectrum lines
         if(!bFinishMesh) {
-            addNextSpectrumToMesh(period);
+            if(bAdaptiveLines) {
+                addAdaptiveSpectrumToMesh();
+            } else {
+                addNextSpectrumToMesh(spectrum, currentAngle);
+                checkpoint.addLine(spectrum, currentAngle, sound.getPositionMS());
+            }
         }
         
         time0 = time;
@@ -151,7 +184,13 @@ void ofApp::draw(){
 }
 
 //--------------------------------------------------------------
-void ofApp::addNextSpectrumToMesh(float period) {
+void ofApp::exit(){
+    // Write out the last queued lines before closing
+    checkpoint.stop();
+}
+
+//--------------------------------------------------------------
+void ofApp::addNextSpectrumToMesh(const vector<float> &values, float angle) {
     
     // Where does the radius start and end
     float radialPosStart = radPostStart; // Values for these are imported from settings.xml file
@@ -169,10 +208,10 @@ void ofApp::addNextSpectrumToMesh(float period) {
         pct = pctStep * i;
         radialPos = (1 - pct) * radialPosStart + (pct) * radialPosEnd;
         
-        // set point x and y from currentAngle rotation
-        float x = cos(currentAngle) * radialPos;
-        float y = sin(currentAngle) * radialPos;
-        float z = spectrum[i] * frequencyScale;
+        // set point x and y from the angle of the line
+        float x = cos(angle) * radialPos;
+        float y = sin(angle) * radialPos;
+        float z = values[i] * frequencyScale;
         
         // Add each point to the mesh
         ofVec3f p(x, y, z);
@@ -237,6 +276,109 @@ void ofApp::addNextSpectrumToMesh(float period) {
 
 }
 
+//--------------------------------------------------------------
+void ofApp::addAdaptiveSpectrumToMesh() {
+    
+    // Always add the first line so there is something to measure the change against
+    if (lastLineSpectrum.empty()) {
+        addNextSpectrumToMesh(spectrum, currentAngle);
+        checkpoint.addLine(spectrum, currentAngle, sound.getPositionMS());
+        lastLineSpectrum = spectrum;
+        lastLineAngle = currentAngle;
+        return;
+    }
+    
+    // If a surface stretched from the last added line to the current spectrum still passes close enough
+    // to every line skipped so far then the current spectrum can wait as well
+    if ((int)pendingSpectra.size() <= adaptiveMaxSkip && canSkipPendingSpectra(spectrum, currentAngle)) {
+        pendingSpectra.push_back(spectrum);
+        pendingAngles.push_back(currentAngle);
+        pendingPositions.push_back(sound.getPositionMS());
+        return;
+    }
+    
+    // Otherwise add the most recent line that was still within the bound, at the angle it was captured at,
+    // and start measuring again from there
+    flushPendingSpectrum();
+    
+    pendingSpectra.push_back(spectrum);
+    pendingAngles.push_back(currentAngle);
+    pendingPositions.push_back(sound.getPositionMS());
+}
+
+//--------------------------------------------------------------
+bool ofApp::canSkipPendingSpectra(const vector<float> &values, float angle) {
+    
+    float angleSpan = angle - lastLineAngle;
+    
+    // The triangles between two lines are straight, so the outer edge cuts inside the arc it replaces.
+    // Stop skipping once that gap would be bigger than the error bound, and never span half the disc
+    if (angleSpan >= PI || radPosEnd * (1 - cos(angleSpan / 2)) > adaptiveErrorBound) {
+        return false;
+    }
+    
+    for (int k = 0; k < pendingSpectra.size(); k++) {
+        
+        // How far round between the last added line and the new one the skipped line was captured
+        float pct = (pendingAngles[k] - lastLineAngle) / angleSpan;
+        
+        for (int i = 0; i < numSpectrumBands; i++) {
+            float interpolated = (1 - pct) * lastLineSpectrum[i] + (pct) * values[i];
+            
+            if (fabs(interpolated - pendingSpectra[k][i]) * frequencyScale > adaptiveErrorBound) {
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
+//--------------------------------------------------------------
+void ofApp::flushPendingSpectrum() {
+    
+    if (pendingSpectra.empty()) {
+        return;
+    }
+    
+    addNextSpectrumToMesh(pendingSpectra.back(), pendingAngles.back());
+    checkpoint.addLine(pendingSpectra.back(), pendingAngles.back(), pendingPositions.back());
+    lastLineSpectrum = pendingSpectra.back();
+    lastLineAngle = pendingAngles.back();
+    
+    pendingSpectra.clear();
+    pendingAngles.clear();
+    pendingPositions.clear();
+}
+
+//--------------------------------------------------------------
+void ofApp::resumeFromCheckpoint() {
+    
+    vector< vector<float> > lines;
+    vector<float> angles;
+    vector<int> positions;
+    
+    if (!checkpoint.load(lines, angles, positions)) {
+        return;
+    }
+    
+    // Adding the lines again in order rebuilds the mesh and the inner and outer vertex indices
+    for (int i = 0; i < lines.size(); i++) {
+        addNextSpectrumToMesh(lines[i], angles[i]);
+    }
+    
+    spectrum = lines.back();
+    currentAngle = angles.back();
+    lastLineSpectrum = lines.back();
+    lastLineAngle = angles.back();
+    
+    // The angle only advances by the nominal period per line and lags behind the audio,
+    // so seek to the track position recorded with the last line instead
+    sound.setPositionMS(positions.back());
+    
+    cout << "resumed " << lines.size() << " lines from " << checkpointFile << endl;
+}
+
 //--------------------------------------------------------------
 void ofApp::connectLastSpectrumToFirst() {
     
@@ -517,6 +659,9 @@ void ofApp::keyReleased(int key){
         case 'm': {
             bFinishMesh = true;
             
+            // Make sure the last skipped spectrum line makes it into the mesh before it is closed up
+            flushPendingSpectrum();
+            
             // Call the functions to finish off the mesh.
             // The order matters, adding the central cylinder and edges adds more vertices to the mesh,
             // connecting the last to the first lines is reliant on the order of the vertices as the were put into the mesh
@@ -526,6 +671,11 @@ void ofApp::keyReleased(int key){
             
             mesh.save("meshdump_" + ofToString(ofGetUnixTime()) + ".ply");
             cout << "Manual mesh dump : meshdump_" + ofToString(ofGetUnixTime()) + ".ply" << endl;
+            
+            // The capture is finished so the next run should start a new one
+            if (checkpointFile != "") {
+                checkpoint.remove();
+            }
             break;
         }
             
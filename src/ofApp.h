@@ -2,6 +2,7 @@
 
 #include "ofMain.h"
 #include "ofxXmlSettings.h"
+#include "CaptureCheckpoint.h"
 
 class ofApp : public ofBaseApp{
 
@@ -9,6 +10,7 @@ class ofApp : public ofBaseApp{
 		void setup();
 		void update();
 		void draw();
+		void exit();
 
 		void keyPressed(int key);
 		void keyReleased(int key);
@@ -34,12 +36,28 @@ class ofApp : public ofBaseApp{
     float radPosEnd;                // Furthest radial point
     float lineResolution;           // Lines per second
     
+    bool bAdaptiveLines;            // Only add a line when the spectrum has changed enough to need one
+    float adaptiveErrorBound;       // Max distance the surface may deviate from the skipped spectrum lines
+    int adaptiveMaxSkip;            // Max number of consecutive lines which can be skipped
+    
     
     int numSpectrumBands;           // Number of bands in spectrum
     vector<float> spectrum;         // Smoothed spectrum values
     vector<int> innerVertexIndices; // Keep an array of all of the start and end vertices in each line
     vector<int> outerVertexIndices;
     
+    // Adaptive line state
+    vector<float> lastLineSpectrum;         // Spectrum values of the last line added to the mesh
+    float lastLineAngle = 0;                // and the angle it was added at
+    vector< vector<float> > pendingSpectra; // Spectrum lines skipped since the last line was added
+    vector<float> pendingAngles;
+    vector<int> pendingPositions;           // Track position in ms when each skipped line was captured
+    
+    // Checkpoint of the lines added so far so a crashed capture can be resumed
+    CaptureCheckpoint checkpoint;
+    string checkpointFile;          // File in the data folder, leave empty to turn checkpoints off
+    int checkpointInterval;         // Milliseconds between writes to the checkpoint file
+    
     //--------------------------------------------------------------
     // Runtime info
     bool bShowInfo = true;          // Draw the spectrum and reportstream data or not
@@ -64,7 +82,15 @@ class ofApp : public ofBaseApp{
     float time0;                    // Regularly add a line to the mesh
     
     // Function which will add vertices and triangles to the mesh
-    void addNextSpectrumToMesh(float period);
+    void addNextSpectrumToMesh(const vector<float> &values, float angle);
+    
+    // Only add the spectrum line when skipping it would take the surface outside adaptiveErrorBound
+    void addAdaptiveSpectrumToMesh();
+    bool canSkipPendingSpectra(const vector<float> &values, float angle);
+    void flushPendingSpectrum();
+    
+    // Rebuild the mesh from the checkpoint file and seek the track to where it left off
+    void resumeFromCheckpoint();
 
     // Function used to finish off the mesh and connect all the vertices into a watertight mesh
     void connectLastSpectrumToFirst();